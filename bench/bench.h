@@ -0,0 +1,29 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+// Helpers shared by the benchmarks. Include after defining _POSIX_C_SOURCE
+// so clock_gettime() is available.
+
+#include "common.h"
+#include <time.h>
+
+#define BENCH_SEED 0x9e3779b97f4a7c15ull
+
+static u64 rng_state = BENCH_SEED;
+
+// xorshift64, fast and good enough for picking sizes and keys
+static inline u64 rng_next(void) {
+  u64 x = rng_state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return rng_state = x;
+}
+
+static inline u64 now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+#endif // BENCH_H_
@@ -0,0 +1,81 @@
+// Compares d-ary heap arities against a binary heap: pushing n random keys
+// and popping them all, and heapifying n keys and popping them all.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "array.h"
+#include "bench.h"
+#include "common.h"
+#include "heap.h"
+#include <stdio.h>
+
+#define u32_less(a, b) ((a) < (b))
+HEAP_DEFINE_ARITY(heap2, u32, u32_less, 2)
+HEAP_DEFINE_ARITY(heap4, u32, u32_less, 4)
+HEAP_DEFINE_ARITY(heap8, u32, u32_less, 8)
+HEAP_DEFINE_ARITY(heap16, u32, u32_less, 16)
+
+#define MIN_LOG2 10
+#define MAX_LOG2 24
+
+// Prints ns per element for push+pop and heapify+pop. The pops are checked
+// to come out in order, since the benchmark is built without safechecks.
+#define BENCH_HEAP(name, keys, n)                                              \
+  ({                                                                           \
+    name##_t h = array_empty(name##_t);                                        \
+    array_reserve(u32, &h, n);                                                 \
+    bool sorted = true;                                                        \
+                                                                               \
+    u64 t0 = now_ns();                                                         \
+    for (usize i = 0; i < n; i++)                                              \
+      name##_push(&h, keys[i]);                                                \
+    u32 prev = 0;                                                              \
+    for (usize i = 0; i < n; i++) {                                            \
+      u32 x = name##_pop(&h);                                                  \
+      sorted &= x >= prev;                                                     \
+      prev = x;                                                                \
+    }                                                                          \
+    u64 t1 = now_ns();                                                         \
+    name##_heapify(&h, (name##_slice_t){.ptr = keys, .len = n});               \
+    prev = 0;                                                                  \
+    for (usize i = 0; i < n; i++) {                                            \
+      u32 x = name##_pop(&h);                                                  \
+      sorted &= x >= prev;                                                     \
+      prev = x;                                                                \
+    }                                                                          \
+    u64 t2 = now_ns();                                                         \
+                                                                               \
+    if (!sorted) {                                                             \
+      fprintf(stderr, #name " popped out of order\n");                         \
+      exit(1);                                                                 \
+    }                                                                          \
+    printf(" %8.1f %8.1f", (double)(t1 - t0) / n, (double)(t2 - t1) / n);      \
+    array_free(&h);                                                            \
+  })
+
+int main() {
+  u32 *keys = malloc(((usize)1 << MAX_LOG2) * sizeof(u32));
+
+  printf("%-6s %17s %17s %17s %17s  (ns/element)\n", "n", "d=2", "d=4", "d=8",
+         "d=16");
+  printf("%-6s", "");
+  for (int i = 0; i < 4; i++)
+    printf(" %8s %8s", "push+pop", "heapify");
+  printf("\n");
+
+  for (int lg = MIN_LOG2; lg <= MAX_LOG2; lg += 2) {
+    usize n = (usize)1 << lg;
+    for (usize i = 0; i < n; i++)
+      keys[i] = (u32)rng_next();
+
+    printf("2^%-4d", lg);
+    BENCH_HEAP(heap2, keys, n);
+    BENCH_HEAP(heap4, keys, n);
+    BENCH_HEAP(heap8, keys, n);
+    BENCH_HEAP(heap16, keys, n);
+    printf("\n");
+  }
+
+  free(keys);
+  return 0;
+}
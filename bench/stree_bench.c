@@ -0,0 +1,101 @@
+// Lookup throughput of STree against binary search over the sorted array,
+// for tables from L1-sized up to well past the last level cache.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "arena.h"
+#include "bench.h"
+#include "common.h"
+#include "stree.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define QUERIES (1 << 22)
+#define MIN_LOG2 10
+#define MAX_LOG2 26
+
+static usize binary_search(const u32 *a, usize n, u32 x) {
+  usize lo = 0, hi = n;
+  while (lo < hi) {
+    usize mid = lo + (hi - lo) / 2;
+    if (a[mid] < x)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Branchless variant, the usual first step before changing the layout
+static usize binary_search_branchless(const u32 *a, usize n, u32 x) {
+  const u32 *base = a;
+  usize len = n;
+  while (len > 1) {
+    usize half = len / 2;
+    base = base[half - 1] < x ? base + half : base;
+    len -= half;
+  }
+  return (usize)(base - a) + (n > 0 && *base < x);
+}
+
+int main() {
+  u32 *keys = malloc(((usize)1 << MAX_LOG2) * sizeof(u32));
+  u32 *queries = malloc(QUERIES * sizeof(u32));
+  usize *expected = malloc(QUERIES * sizeof(usize));
+  usize *out = malloc(QUERIES * sizeof(usize));
+
+  printf("%-10s %10s %10s %10s %10s  (ns/query)\n", "keys", "bsearch",
+         "branchless", "stree", "batch");
+
+  for (int lg = MIN_LOG2; lg <= MAX_LOG2; lg += 2) {
+    usize n = (usize)1 << lg;
+    // Sorted keys with random gaps, so about half the queries are misses
+    u32 key = 0;
+    for (usize i = 0; i < n; i++) {
+      key += 1 + (u32)(rng_next() % 2);
+      keys[i] = key;
+    }
+    for (usize i = 0; i < QUERIES; i++)
+      queries[i] = (u32)(rng_next() % ((u64)key + 2));
+
+    STree tree = stree_build((u32slice_t){.ptr = keys, .len = n}, NULL);
+    volatile usize sink = 0;
+
+    u64 t0 = now_ns();
+    for (usize i = 0; i < QUERIES; i++)
+      expected[i] = binary_search(keys, n, queries[i]);
+    u64 t1 = now_ns();
+    for (usize i = 0; i < QUERIES; i++)
+      sink += binary_search_branchless(keys, n, queries[i]);
+    u64 t2 = now_ns();
+    for (usize i = 0; i < QUERIES; i++)
+      out[i] = stree_lower_bound(&tree, queries[i]);
+    u64 t3 = now_ns();
+    // Built without safechecks, so compare against binary search explicitly
+    usize mismatches = 0;
+    for (usize i = 0; i < QUERIES; i++)
+      mismatches += out[i] != expected[i];
+    u64 t4 = now_ns();
+    stree_lower_bound_batch(&tree, queries, QUERIES, out);
+    u64 t5 = now_ns();
+    for (usize i = 0; i < QUERIES; i++)
+      mismatches += out[i] != expected[i];
+    if (mismatches) {
+      fprintf(stderr, "%zu results differ from binary search\n", mismatches);
+      return 1;
+    }
+
+    char label[32];
+    snprintf(label, sizeof(label), "2^%d", lg);
+    printf("%-10s %10.1f %10.1f %10.1f %10.1f\n", label,
+           (double)(t1 - t0) / QUERIES, (double)(t2 - t1) / QUERIES,
+           (double)(t3 - t2) / QUERIES, (double)(t5 - t4) / QUERIES);
+    stree_free(&tree);
+  }
+
+  free(out);
+  free(expected);
+  free(queries);
+  free(keys);
+  return 0;
+}
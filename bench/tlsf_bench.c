@@ -0,0 +1,152 @@
+// Mixed-size churn benchmark comparing Tlsf against the system malloc.
+//
+// Keeps a fixed number of live slots and repeatedly frees a random slot and
+// refills it with a new allocation, reporting per-operation latency
+// percentiles and the memory footprint at the end.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "arena.h"
+#include "bench.h"
+#include "common.h"
+#include "tlsf.h"
+#include <stdio.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#define SLOTS 65536
+#define OPS 4000000
+#define POOL_SIZE (16 << 20)
+
+typedef struct Sample {
+  u64 *ns;
+  usize len;
+} Sample;
+
+// 80% small (16-256), 15% medium (256-4K), 5% large (4K-64K)
+static inline usize random_size(void) {
+  u64 r = rng_next();
+  u64 bucket = r % 100;
+  r >>= 8;
+  if (bucket < 80)
+    return 16 + r % 240;
+  if (bucket < 95)
+    return 256 + r % 3840;
+  return 4096 + r % 61440;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+  u64 x = *(const u64 *)a, y = *(const u64 *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, Sample *s, u64 total_ns, usize live,
+                   usize footprint) {
+  qsort(s->ns, s->len, sizeof(u64), cmp_u64);
+  printf("%-8s %8.1f ns/op  p50 %5llu  p99 %6llu  p99.9 %7llu  max %8llu ns",
+         name, (double)total_ns / (double)s->len,
+         (unsigned long long)s->ns[s->len / 2],
+         (unsigned long long)s->ns[s->len * 99 / 100],
+         (unsigned long long)s->ns[s->len * 999 / 1000],
+         (unsigned long long)s->ns[s->len - 1]);
+  if (footprint)
+    printf("  live %6.1f MiB  footprint %6.1f MiB  (%.2fx)", live / 1048576.0,
+           footprint / 1048576.0, (double)footprint / (double)live);
+  printf("\n");
+}
+
+typedef void *(*alloc_fn)(void *ctx, usize size);
+typedef void (*free_fn)(void *ctx, void *ptr);
+
+static void *sys_alloc(void *ctx, usize size) { return malloc(size); }
+static void sys_free(void *ctx, void *ptr) { free(ptr); }
+static void *tlsf_alloc_fn(void *ctx, usize size) {
+  return tlsf_malloc(ctx, size);
+}
+static void tlsf_free_fn(void *ctx, void *ptr) { tlsf_free(ctx, ptr); }
+
+#if defined(__GLIBC__)
+static usize sys_heap_size(void) {
+  struct mallinfo2 info = mallinfo2();
+  return info.arena + info.hblkhd;
+}
+// Heap in use before the benchmark, e.g. the latency samples
+static usize sys_baseline;
+#endif
+
+// Bytes of memory obtained from the system
+static usize sys_footprint(void *ctx) {
+#if defined(__GLIBC__)
+  return sys_heap_size() - sys_baseline;
+#else
+  return 0;
+#endif
+}
+
+static usize tlsf_footprint(void *ctx) {
+  Tlsf *tlsf = ctx;
+  usize pools = 0;
+  for (TlsfPool *pool = tlsf->owned_pools; pool; pool = pool->next)
+    pools++;
+  return pools * POOL_SIZE;
+}
+
+static void run(const char *name, void *ctx, alloc_fn alloc, free_fn dealloc,
+                usize (*footprint)(void *ctx), Sample *s) {
+  static void *slots[SLOTS];
+  static usize sizes[SLOTS];
+  usize live = 0;
+
+  rng_state = BENCH_SEED;
+  for (usize i = 0; i < SLOTS; i++) {
+    sizes[i] = random_size();
+    slots[i] = alloc(ctx, sizes[i]);
+    memset(slots[i], (int)i, sizes[i] < 64 ? sizes[i] : 64);
+    live += sizes[i];
+  }
+
+  s->len = 0;
+  u64 begin = now_ns();
+  for (usize op = 0; op < OPS; op++) {
+    usize i = rng_next() % SLOTS;
+    usize size = random_size();
+
+    u64 t0 = now_ns();
+    dealloc(ctx, slots[i]);
+    void *p = alloc(ctx, size);
+    u64 t1 = now_ns();
+
+    // Touch the memory so neither allocator gets away with lazy mapping
+    memset(p, (int)op, size < 64 ? size : 64);
+    live += size - sizes[i];
+    slots[i] = p;
+    sizes[i] = size;
+    s->ns[s->len++] = t1 - t0;
+  }
+  u64 total_ns = now_ns() - begin;
+
+  report(name, s, total_ns, live, footprint(ctx));
+  for (usize i = 0; i < SLOTS; i++)
+    dealloc(ctx, slots[i]);
+}
+
+int main() {
+  Sample s = {.ns = malloc(OPS * sizeof(u64)), .len = 0};
+
+  printf("%d live slots, %d free+malloc pairs, sizes 16B-64KiB\n", SLOTS, OPS);
+
+#if defined(__GLIBC__)
+  sys_baseline = sys_heap_size();
+#endif
+  run("malloc", NULL, sys_alloc, sys_free, sys_footprint, &s);
+
+  Tlsf tlsf;
+  tlsf_init(&tlsf, NULL, POOL_SIZE);
+  run("tlsf", &tlsf, tlsf_alloc_fn, tlsf_free_fn, tlsf_footprint, &s);
+  tlsf_destroy(&tlsf);
+
+  free(s.ns);
+  return 0;
+}
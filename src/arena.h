@@ -36,6 +36,11 @@ struct Arena {
   ArenaBlockList available_blocks;
 };
 
+// Allocates `size` bytes aligned to ZMEM_L1_CACHE_LINE_SIZE, returns NULL on
+// failure
+void *alloc_aligned(usize size);
+void free_aligned(void *ptr);
+
 Arena arena_new(usize *block_size);
 void *arena_alloc(Arena *arena, usize n_bytes);
 void arena_reset(Arena *arena);
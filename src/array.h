@@ -1,9 +1,20 @@
 #include "common.h"
 
-#pragma once
-ASSUME_NONNULL_BEGIN
+#ifdef ARRAY_H_
+// The allocator is fixed by the first include, so an override that shows up
+// afterwards would be silently ignored
+#if defined(ARRAY_MALLOC) && !defined(ARRAY_CUSTOM_ALLOCATOR)
+#error "ARRAY_MALLOC must be defined before array.h is first included"
+#endif
+#else
 
-#ifndef ARRAY_H_
+// Lets a build supply its own allocator, see below. The header must not
+// include array.h itself.
+#ifdef ARRAY_ALLOCATOR_HEADER
+#include ARRAY_ALLOCATOR_HEADER
+#endif
+
+ASSUME_NONNULL_BEGIN
 
 typedef struct {
   u8 *maybe_null ptr;
@@ -47,6 +58,30 @@ typedef union {
     usize len;                                                                 \
   }
 
+// Allocator used for array storage. Define ARRAY_MALLOC, ARRAY_REALLOC and
+// ARRAY_FREE before the first include of this header (or of any header that
+// includes it) to place arrays somewhere other than the malloc heap, e.g. a
+// Tlsf.
+//
+// The functions below are compiled into every translation unit separately, so
+// all code that allocates, grows or frees the same array, including bitset.c
+// and generated heap functions, must see the same definition. To do that for
+// the whole build, put the definitions and whatever they refer to in a header
+// and pass -DARRAY_ALLOCATOR_HEADER='"that_header.h"'.
+#ifdef ARRAY_MALLOC
+#if !defined(ARRAY_REALLOC) || !defined(ARRAY_FREE)
+#error "ARRAY_MALLOC requires ARRAY_REALLOC and ARRAY_FREE to be defined too"
+#endif
+#define ARRAY_CUSTOM_ALLOCATOR 1
+#define _ARRAY_MALLOC(size) ARRAY_MALLOC(size)
+#define _ARRAY_REALLOC(ptr, size) ARRAY_REALLOC(ptr, size)
+#define _ARRAY_FREE(ptr) ARRAY_FREE(ptr)
+#else
+#define _ARRAY_MALLOC(size) malloc(size)
+#define _ARRAY_REALLOC(ptr, size) realloc(ptr, size)
+#define _ARRAY_FREE(ptr) free(ptr)
+#endif
+
 #define slice_empty(T) ((T){.ptr = NULL, .len = 0})
 
 #define array_index_checked(T, s, i)                                           \
@@ -71,23 +106,23 @@ typedef union {
 
 #endif
 
-slice_t _array_as_slice(array_t *arr) {
+static inline slice_t _array_as_slice(array_t *arr) {
   return (slice_t){
       .ptr = arr->ptr,
       .len = arr->len,
   };
 }
 
-void _array_init(array_t *arr, usize cap, usize elem_size) {
+static inline void _array_init(array_t *arr, usize cap, usize elem_size) {
   usize actual_cap = cap < 4 ? 4 : cap;
-  u8 *ptr = (u8 *)malloc(elem_size * actual_cap);
+  u8 *ptr = (u8 *)_ARRAY_MALLOC(elem_size * actual_cap);
   arr->ptr = ptr;
   arr->cap = actual_cap;
   arr->len = 0;
 }
 
-void _array_free(array_t *arr) {
-  free(arr->ptr);
+static inline void _array_free(array_t *arr) {
+  _ARRAY_FREE(arr->ptr);
   arr->ptr = NULL;
   arr->cap = 0;
   arr->len = 0;
@@ -113,7 +148,7 @@ static inline bool _array_check_overlap(const array_t *a, const array_t *b,
 #define GROW_CAPACITY(capacity) ((capacity) < 8 ? 8 : (capacity)*2)
 #define MIN_X(a, b) ((a) < (b) ? (a) : (b))
 
-static bool array_resize(array_t *a, usize elemsize, usize newcap) {
+static inline bool array_resize(array_t *a, usize elemsize, usize newcap) {
   assert(newcap >= a->len);
 
   if (a->cap == newcap)
@@ -123,16 +158,18 @@ static bool array_resize(array_t *a, usize elemsize, usize newcap) {
   if (check_mul_overflow((usize)newcap, (usize)elemsize, &newsize))
     return false;
 
-  a->ptr =
-      // is realloc on NULL fucked?
-      a->ptr == NULL ? ((u8 *)malloc(newsize * elemsize))
-                     : (u8 *)realloc(a->ptr, newsize);
+  // On failure the array is left as it was
+  u8 *ptr = a->ptr == NULL ? (u8 *)_ARRAY_MALLOC(newsize)
+                           : (u8 *)_ARRAY_REALLOC(a->ptr, newsize);
+  if (ptr == NULL)
+    return false;
 
+  a->ptr = ptr;
   a->cap = newcap;
   return true;
 }
 
-bool array_grow(array_t *a, usize elemsize, usize extracap) {
+static inline bool array_grow(array_t *a, usize elemsize, usize extracap) {
   usize newcap;
   if (a->cap == 0) {
     // initial allocation
@@ -161,16 +198,17 @@ bool array_grow(array_t *a, usize elemsize, usize extracap) {
   return array_resize(a, elemsize, newcap);
 }
 
-void _array_reserve(array_t *arr, usize elem_size, usize amount) {
+// Returns false if the allocation failed, leaving the array unchanged
+static inline bool _array_reserve(array_t *arr, usize elem_size, usize amount) {
   usize avail = arr->cap - arr->len;
   if (amount <= avail)
-    return;
+    return true;
 
   usize amount_to_grow = amount - avail;
-  array_grow(arr, elem_size, amount_to_grow);
+  return array_grow(arr, elem_size, amount_to_grow);
 }
 
-void _array_concat(array_t *dest, const array_t *src, usize elem_size) {
+static inline void _array_concat(array_t *dest, const array_t *src, usize elem_size) {
   _array_reserve(dest, elem_size, src->len);
   if (UNLIKELY(_array_check_overlap(dest, src, elem_size))) {
     memmove(&dest->ptr[dest->len * elem_size], src->ptr, src->len * elem_size);
@@ -180,22 +218,22 @@ void _array_concat(array_t *dest, const array_t *src, usize elem_size) {
   dest->len += src->len;
 }
 
-void _array_shrink_to_fit(array_t *arr) {
+static inline void _array_shrink_to_fit(array_t *arr) {
   if (arr->cap == arr->len) {
     return;
   }
-  arr->ptr = (u8 *)realloc(arr->ptr, arr->len);
+  arr->ptr = (u8 *)_ARRAY_REALLOC(arr->ptr, arr->len);
   arr->cap = arr->len;
 }
 
-void _array_copy(array_t *dest, const array_t *src, usize elem_size) {
-  u8 *ptr = (u8 *)malloc(src->len * elem_size);
+static inline void _array_copy(array_t *dest, const array_t *src, usize elem_size) {
+  u8 *ptr = (u8 *)_ARRAY_MALLOC(src->len * elem_size);
   dest->ptr = ptr;
   dest->len = src->len;
   dest->cap = src->len;
 }
 
-void _array_erase(array_t *arr, usize idx, usize elem_size) {
+static inline void _array_erase(array_t *arr, usize idx, usize elem_size) {
   safecheck(arr->len > 0);
   // shift all elements after to the left by one
   if (idx < arr->len - 1) {
@@ -0,0 +1,284 @@
+#include "bitset.h"
+#include "arena.h"
+#include "array.h"
+#include "common.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BITSET_HAVE_AVX2
+#endif
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#define BITSET_HAVE_BMI2
+#endif
+
+// Mask of the valid bits in the last word
+static inline u64 bitset_tail_mask(usize nbits) {
+  usize rem = nbits % BITSET_WORD_BITS;
+  return rem == 0 ? ~(u64)0 : ((u64)1 << rem) - 1;
+}
+
+bitset_t bitset_new(usize nbits) {
+  bitset_t bs = {
+      .words = array_empty(u64array_t),
+      .nbits = 0,
+      .arena = NULL,
+  };
+  bitset_resize(&bs, nbits);
+  return bs;
+}
+
+bitset_t bitset_new_in(Arena *arena, usize nbits) {
+  bitset_t bs = {
+      .words = array_empty(u64array_t),
+      .nbits = 0,
+      .arena = arena,
+  };
+  bitset_resize(&bs, nbits);
+  return bs;
+}
+
+void bitset_free(bitset_t *bs) {
+  if (!bs->arena)
+    array_free(&bs->words);
+  bs->words = array_empty(u64array_t);
+  bs->nbits = 0;
+}
+
+bool bitset_resize(bitset_t *bs, usize nbits) {
+  usize old_nwords = bs->words.len;
+  usize nwords = BITSET_NWORDS(nbits);
+
+  if (nwords > bs->words.cap) {
+    if (bs->arena) {
+      u64 *ptr = arena_alloc(bs->arena, nwords * sizeof(u64));
+      if (!ptr)
+        return false;
+      if (old_nwords)
+        memcpy(ptr, bs->words.ptr, old_nwords * sizeof(u64));
+      bs->words.ptr = ptr;
+      bs->words.cap = nwords;
+    } else if (!array_reserve(u64, &bs->words, nwords - bs->words.len)) {
+      return false;
+    }
+  }
+
+  if (nwords > old_nwords)
+    memset(&bs->words.ptr[old_nwords], 0,
+           (nwords - old_nwords) * sizeof(u64));
+  bs->words.len = nwords;
+  bs->nbits = nbits;
+
+  // Growing keeps the tail invariant since the old tail bits were zero, but
+  // shrinking may leave set bits past the new length.
+  if (nwords)
+    bs->words.ptr[nwords - 1] &= bitset_tail_mask(nbits);
+  return true;
+}
+
+void bitset_set_all(bitset_t *bs) {
+  if (!bs->words.len)
+    return;
+  memset(bs->words.ptr, 0xff, bs->words.len * sizeof(u64));
+  bs->words.ptr[bs->words.len - 1] = bitset_tail_mask(bs->nbits);
+}
+
+void bitset_clear_all(bitset_t *bs) {
+  if (!bs->words.len)
+    return;
+  memset(bs->words.ptr, 0, bs->words.len * sizeof(u64));
+}
+
+// Defines a binary word-wise operation. The AVX2 path handles four words per
+// iteration with unaligned loads, since array- and arena-backed storage only
+// guarantee malloc alignment; the scalar loop handles the remainder.
+#ifdef BITSET_HAVE_AVX2
+#define BITSET_BINOP(name, OP, AVX_OP)                                         \
+  void name(bitset_t *dst, const bitset_t *src) {                              \
+    safecheck(dst->nbits == src->nbits);                                       \
+    u64 *d = dst->words.ptr;                                                   \
+    const u64 *s = src->words.ptr;                                             \
+    usize n = dst->words.len, i = 0;                                           \
+    for (; i + 4 <= n; i += 4) {                                               \
+      __m256i a = _mm256_loadu_si256((const __m256i *)&d[i]);                  \
+      __m256i b = _mm256_loadu_si256((const __m256i *)&s[i]);                  \
+      _mm256_storeu_si256((__m256i *)&d[i], AVX_OP(a, b));                     \
+    }                                                                          \
+    for (; i < n; i++)                                                         \
+      d[i] = OP(d[i], s[i]);                                                   \
+  }
+#else
+#define BITSET_BINOP(name, OP, AVX_OP)                                         \
+  void name(bitset_t *dst, const bitset_t *src) {                              \
+    safecheck(dst->nbits == src->nbits);                                       \
+    u64 *d = dst->words.ptr;                                                   \
+    const u64 *s = src->words.ptr;                                             \
+    usize n = dst->words.len;                                                  \
+    for (usize i = 0; i < n; i++)                                              \
+      d[i] = OP(d[i], s[i]);                                                   \
+  }
+#endif
+
+#define BITSET_OP_AND(a, b) ((a) & (b))
+#define BITSET_OP_OR(a, b) ((a) | (b))
+#define BITSET_OP_XOR(a, b) ((a) ^ (b))
+#define BITSET_OP_ANDNOT(a, b) ((a) & ~(b))
+// _mm256_andnot_si256 computes ~first & second
+#define BITSET_AVX_ANDNOT(a, b) _mm256_andnot_si256(b, a)
+
+BITSET_BINOP(bitset_and, BITSET_OP_AND, _mm256_and_si256)
+BITSET_BINOP(bitset_or, BITSET_OP_OR, _mm256_or_si256)
+BITSET_BINOP(bitset_xor, BITSET_OP_XOR, _mm256_xor_si256)
+BITSET_BINOP(bitset_andnot, BITSET_OP_ANDNOT, BITSET_AVX_ANDNOT)
+
+#ifdef BITSET_HAVE_AVX2
+// Nibble lookup popcount (Mula et al., "Faster Population Counts Using AVX2
+// Instructions"). Returns per-64-bit-lane counts.
+static inline __m256i bitset_popcount256(__m256i v) {
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1,
+                       2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i lo = _mm256_and_si256(v, low_mask);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+  __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                _mm256_shuffle_epi8(lookup, hi));
+  return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+#endif
+
+static usize bitset_popcount_words(const u64 *words, usize n) {
+  usize count = 0, i = 0;
+#ifdef BITSET_HAVE_AVX2
+  __m256i acc = _mm256_setzero_si256();
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)&words[i]);
+    acc = _mm256_add_epi64(acc, bitset_popcount256(v));
+  }
+  count += (usize)_mm256_extract_epi64(acc, 0) +
+           (usize)_mm256_extract_epi64(acc, 1) +
+           (usize)_mm256_extract_epi64(acc, 2) +
+           (usize)_mm256_extract_epi64(acc, 3);
+#endif
+  for (; i < n; i++)
+    count += (usize)__builtin_popcountll(words[i]);
+  return count;
+}
+
+usize bitset_popcount(const bitset_t *bs) {
+  return bitset_popcount_words(bs->words.ptr, bs->words.len);
+}
+
+usize bitset_rank(const bitset_t *bs, usize i) {
+  if (i >= bs->nbits)
+    return bitset_popcount(bs);
+  usize w = i / BITSET_WORD_BITS;
+  usize count = bitset_popcount_words(bs->words.ptr, w);
+  usize rem = i % BITSET_WORD_BITS;
+  if (rem)
+    count += (usize)__builtin_popcountll(bs->words.ptr[w] &
+                                         (((u64)1 << rem) - 1));
+  return count;
+}
+
+// Position of the k-th set bit within a word, k < popcount(word)
+static inline usize bitset_select_word(u64 word, usize k) {
+#ifdef BITSET_HAVE_BMI2
+  return (usize)co_ctz((u64)_pdep_u64((u64)1 << k, word));
+#else
+  for (; k; k--)
+    word &= word - 1;
+  return (usize)co_ctz(word);
+#endif
+}
+
+usize bitset_select(const bitset_t *bs, usize k) {
+  for (usize w = 0; w < bs->words.len; w++) {
+    u64 word = bs->words.ptr[w];
+    usize count = (usize)__builtin_popcountll(word);
+    if (k < count)
+      return w * BITSET_WORD_BITS + bitset_select_word(word, k);
+    k -= count;
+  }
+  return bs->nbits;
+}
+
+bitset_rank_index_t bitset_rank_index_build(const bitset_t *bs,
+                                            Arena *maybe_null arena) {
+  usize nsuper =
+      (bs->words.len + BITSET_SUPERBLOCK_WORDS - 1) / BITSET_SUPERBLOCK_WORDS;
+  bitset_rank_index_t idx = {
+      .counts = array_empty(u64array_t),
+      .arena = arena,
+  };
+  if (arena) {
+    idx.counts.ptr = arena_alloc(arena, (nsuper + 1) * sizeof(u64));
+    if (!idx.counts.ptr)
+      return idx;
+    idx.counts.cap = nsuper + 1;
+  } else if (!array_reserve(u64, &idx.counts, nsuper + 1)) {
+    return idx;
+  }
+
+  u64 total = 0;
+  for (usize s = 0; s < nsuper; s++) {
+    idx.counts.ptr[s] = total;
+    usize w = s * BITSET_SUPERBLOCK_WORDS;
+    total += bitset_popcount_words(
+        &bs->words.ptr[w], MIN_X(BITSET_SUPERBLOCK_WORDS, bs->words.len - w));
+  }
+  idx.counts.ptr[nsuper] = total;
+  idx.counts.len = nsuper + 1;
+  return idx;
+}
+
+void bitset_rank_index_free(bitset_rank_index_t *idx) {
+  if (!idx->arena)
+    array_free(&idx->counts);
+  idx->counts = array_empty(u64array_t);
+}
+
+usize bitset_rank_indexed(const bitset_t *bs, const bitset_rank_index_t *idx,
+                          usize i) {
+  if (i >= bs->nbits)
+    return idx->counts.ptr[idx->counts.len - 1];
+  usize w = i / BITSET_WORD_BITS;
+  usize super = w / BITSET_SUPERBLOCK_WORDS;
+  usize first = super * BITSET_SUPERBLOCK_WORDS;
+  usize count = idx->counts.ptr[super];
+  for (usize j = first; j < w; j++)
+    count += (usize)__builtin_popcountll(bs->words.ptr[j]);
+  usize rem = i % BITSET_WORD_BITS;
+  if (rem)
+    count += (usize)__builtin_popcountll(bs->words.ptr[w] &
+                                         (((u64)1 << rem) - 1));
+  return count;
+}
+
+usize bitset_select_indexed(const bitset_t *bs, const bitset_rank_index_t *idx,
+                            usize k) {
+  usize nsuper = idx->counts.len - 1;
+  if (k >= idx->counts.ptr[nsuper])
+    return bs->nbits;
+
+  // Last superblock starting with fewer than k+1 set bits before it
+  usize lo = 0, hi = nsuper;
+  while (hi - lo > 1) {
+    usize mid = lo + (hi - lo) / 2;
+    if (idx->counts.ptr[mid] <= k)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  k -= idx->counts.ptr[lo];
+  for (usize w = lo * BITSET_SUPERBLOCK_WORDS; w < bs->words.len; w++) {
+    u64 word = bs->words.ptr[w];
+    usize count = (usize)__builtin_popcountll(word);
+    if (k < count)
+      return w * BITSET_WORD_BITS + bitset_select_word(word, k);
+    k -= count;
+  }
+  return bs->nbits;
+}
@@ -0,0 +1,150 @@
+#ifndef BITSET_H_
+#define BITSET_H_
+
+#include "arena.h"
+#include "array.h"
+#include "common.h"
+
+ASSUME_NONNULL_BEGIN
+
+// A dynamically sized bitset stored as an array of u64 words.
+//
+// Bits past `nbits` in the last word are always kept zero, so bulk operations
+// and popcounts can work on whole words without masking.
+//
+// When `arena` is non-NULL the words are owned by the arena: they are never
+// freed individually and growing the bitset copies into a fresh allocation.
+
+typedef array_type(u64) u64array_t;
+
+typedef struct bitset_t {
+  u64array_t words;
+  usize nbits;
+  Arena *maybe_null arena;
+} bitset_t;
+
+#define BITSET_WORD_BITS 64
+#define BITSET_NWORDS(nbits) (((nbits) + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS)
+
+// Both return an empty bitset (nbits 0) if the allocation fails
+bitset_t bitset_new(usize nbits);
+bitset_t bitset_new_in(Arena *arena, usize nbits);
+void bitset_free(bitset_t *bs);
+// Grows or shrinks the bitset, newly added bits are zero. Returns false and
+// leaves the bitset unchanged if the allocation fails.
+bool bitset_resize(bitset_t *bs, usize nbits);
+
+void bitset_set_all(bitset_t *bs);
+void bitset_clear_all(bitset_t *bs);
+
+// dst = dst OP src. Both bitsets must have the same length.
+void bitset_and(bitset_t *dst, const bitset_t *src);
+void bitset_or(bitset_t *dst, const bitset_t *src);
+void bitset_xor(bitset_t *dst, const bitset_t *src);
+// dst = dst & ~src
+void bitset_andnot(bitset_t *dst, const bitset_t *src);
+
+// Number of set bits
+usize bitset_popcount(const bitset_t *bs);
+// Number of set bits in [0, i). O(i/64), scans the words before `i`.
+usize bitset_rank(const bitset_t *bs, usize i);
+// Position of the k-th (0-based) set bit, or `nbits` if there are not enough.
+// O(nbits/64), scans words until the k-th bit is found.
+//
+// For repeated queries on a bitset that is no longer changing, build a
+// bitset_rank_index_t and use the _indexed variants below instead.
+usize bitset_select(const bitset_t *bs, usize k);
+
+// Number of set bits before every 512-bit (8 word) superblock, plus the
+// total at the end. It costs 1/8th of the bitset's size and must be rebuilt
+// after the bitset is modified. bitset_rank_index_build() returns an index
+// with no counts (counts.len 0) if the allocation fails.
+typedef struct bitset_rank_index_t {
+  u64array_t counts;
+  Arena *maybe_null arena;
+} bitset_rank_index_t;
+
+#define BITSET_SUPERBLOCK_WORDS 8
+
+bitset_rank_index_t bitset_rank_index_build(const bitset_t *bs,
+                                            Arena *maybe_null arena);
+void bitset_rank_index_free(bitset_rank_index_t *idx);
+// Same as bitset_rank(), O(1)
+usize bitset_rank_indexed(const bitset_t *bs, const bitset_rank_index_t *idx,
+                          usize i);
+// Same as bitset_select(), O(log(nbits / 512)) to find the superblock
+usize bitset_select_indexed(const bitset_t *bs, const bitset_rank_index_t *idx,
+                            usize k);
+
+static inline bool bitset_test(const bitset_t *bs, usize i) {
+  safecheck(i < bs->nbits);
+  return (bs->words.ptr[i / BITSET_WORD_BITS] >> (i % BITSET_WORD_BITS)) & 1;
+}
+
+static inline void bitset_set(bitset_t *bs, usize i) {
+  safecheck(i < bs->nbits);
+  bs->words.ptr[i / BITSET_WORD_BITS] |= (u64)1 << (i % BITSET_WORD_BITS);
+}
+
+static inline void bitset_clear(bitset_t *bs, usize i) {
+  safecheck(i < bs->nbits);
+  bs->words.ptr[i / BITSET_WORD_BITS] &= ~((u64)1 << (i % BITSET_WORD_BITS));
+}
+
+static inline void bitset_flip(bitset_t *bs, usize i) {
+  safecheck(i < bs->nbits);
+  bs->words.ptr[i / BITSET_WORD_BITS] ^= (u64)1 << (i % BITSET_WORD_BITS);
+}
+
+// Returns the position of the first set bit >= i, or `nbits` if there is none
+static inline usize bitset_next(const bitset_t *bs, usize i) {
+  if (i >= bs->nbits)
+    return bs->nbits;
+  usize w = i / BITSET_WORD_BITS;
+  u64 word = bs->words.ptr[w] & (~(u64)0 << (i % BITSET_WORD_BITS));
+  while (word == 0) {
+    if (++w >= bs->words.len)
+      return bs->nbits;
+    word = bs->words.ptr[w];
+  }
+  return w * BITSET_WORD_BITS + (usize)co_ctz(word);
+}
+
+// Iterates set bits in ascending order, keeping the current word in a
+// register and clearing the lowest bit on every step.
+typedef struct bitset_iter_t {
+  const u64 *words;
+  usize nwords;
+  usize word_idx;
+  u64 cur;
+} bitset_iter_t;
+
+static inline bitset_iter_t bitset_iter(const bitset_t *bs) {
+  return (bitset_iter_t){
+      .words = bs->words.ptr,
+      .nwords = bs->words.len,
+      .word_idx = 0,
+      .cur = bs->words.len ? bs->words.ptr[0] : 0,
+  };
+}
+
+static inline bool bitset_iter_next(bitset_iter_t *it, usize *out) {
+  while (it->cur == 0) {
+    if (++it->word_idx >= it->nwords)
+      return false;
+    it->cur = it->words[it->word_idx];
+  }
+  *out = it->word_idx * BITSET_WORD_BITS + (usize)co_ctz(it->cur);
+  it->cur &= it->cur - 1;
+  return true;
+}
+
+// bitset_foreach(&bs, i) { ... } runs the body for every set bit `i`
+#define bitset_foreach(bs, i)                                                  \
+  for (bitset_iter_t i##__it = bitset_iter(bs), *i##__p = &i##__it; i##__p;   \
+       i##__p = NULL)                                                          \
+    for (usize i; bitset_iter_next(&i##__it, &i);)
+
+ASSUME_NONNULL_END
+
+#endif // BITSET_H_
@@ -0,0 +1,244 @@
+#ifndef HEAP_H_
+#define HEAP_H_
+
+#include "array.h"
+#include "common.h"
+
+ASSUME_NONNULL_BEGIN
+
+// Type-specialized d-ary min-heaps stored in an `array_type(T)` layout.
+//
+// A wider heap is shallower, and the children of a node are contiguous so
+// finding the smallest of them touches one or two cache lines. The default
+// arity of 4 does fewer cache misses than a binary heap without making each
+// sift down step much more expensive, see bench/heap_bench.c.
+//
+//   #define u32_less(a, b) ((a) < (b))
+//   HEAP_DEFINE(u32heap, u32, u32_less)
+//
+//   u32heap_t heap = array_empty(u32heap_t);
+//   u32heap_push(&heap, 420);
+//   u32 min = u32heap_pop(&heap);
+//   array_free(&heap);
+//
+// Generated functions, where `name_t` is the heap type:
+//
+//   bool name_push(name_t *h, T val)
+//   T    name_pop(name_t *h)
+//   T    name_peek(const name_t *h)
+//   bool name_heapify(name_t *h, name_slice_t items)
+//     Appends `items` and restores the heap property in O(n). Returns false
+//     and leaves the heap unchanged if the allocation fails.
+//   bool name_topk_push(name_t *h, usize k, T val)
+//     Keeps the k greatest values seen, returns false if `val` was dropped.
+//     The root is then the smallest of the top k.
+//
+// HEAP_DEFINE_INDEXED() generates a heap where every entry has a u32 id,
+// supporting name_decrease_key() for algorithms like Dijkstra's.
+
+#define HEAP_DEFAULT_ARITY 4
+#define HEAP_NONE UINT32_MAX
+
+#define HEAP_DEFINE(name, T, LESS)                                             \
+  HEAP_DEFINE_ARITY(name, T, LESS, HEAP_DEFAULT_ARITY)
+
+#define HEAP_DEFINE_ARITY(name, T, LESS, D)                                    \
+  static_assert((D) >= 2, "Heap arity must be at least 2");                    \
+  typedef slice_type(T) name##_slice_t;                                        \
+  typedef array_type_with_slice(T, name##_slice_t) name##_t;                   \
+                                                                               \
+  static inline void name##_sift_up(name##_t *h, usize i) {                    \
+    T *a = h->ptr;                                                             \
+    T val = a[i];                                                              \
+    while (i > 0) {                                                            \
+      usize parent = (i - 1) / (D);                                            \
+      if (!LESS(val, a[parent]))                                               \
+        break;                                                                 \
+      a[i] = a[parent];                                                        \
+      i = parent;                                                              \
+    }                                                                          \
+    a[i] = val;                                                                \
+  }                                                                            \
+                                                                               \
+  static inline void name##_sift_down(name##_t *h, usize i) {                  \
+    T *a = h->ptr;                                                             \
+    usize len = h->len;                                                        \
+    T val = a[i];                                                              \
+    for (;;) {                                                                 \
+      usize first = i * (D) + 1;                                               \
+      if (first >= len)                                                        \
+        break;                                                                 \
+      usize last = MIN_X(first + (D), len);                                    \
+      usize best = first;                                                      \
+      for (usize c = first + 1; c < last; c++)                                 \
+        best = LESS(a[c], a[best]) ? c : best;                                 \
+      if (!LESS(a[best], val))                                                 \
+        break;                                                                 \
+      a[i] = a[best];                                                          \
+      i = best;                                                                \
+    }                                                                          \
+    a[i] = val;                                                                \
+  }                                                                            \
+                                                                               \
+  static inline bool name##_push(name##_t *h, T val) {                         \
+    if (!array_push(T, h, val))                                                \
+      return false;                                                            \
+    name##_sift_up(h, h->len - 1);                                             \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline T name##_peek(const name##_t *h) {                             \
+    safecheck(h->len > 0);                                                     \
+    return h->ptr[0];                                                          \
+  }                                                                            \
+                                                                               \
+  static inline T name##_pop(name##_t *h) {                                    \
+    safecheck(h->len > 0);                                                     \
+    T *a = h->ptr;                                                             \
+    T top = a[0];                                                              \
+    if (--h->len > 0) {                                                        \
+      a[0] = a[h->len];                                                        \
+      name##_sift_down(h, 0);                                                  \
+    }                                                                          \
+    return top;                                                                \
+  }                                                                            \
+                                                                               \
+  static inline bool name##_heapify(name##_t *h, name##_slice_t items) {       \
+    if (items.len) {                                                           \
+      if (!array_reserve(T, h, items.len))                                     \
+        return false;                                                          \
+      memcpy(&h->ptr[h->len], items.ptr, items.len * sizeof(T));               \
+      h->len += items.len;                                                     \
+    }                                                                          \
+    /* Floyd's method: sift down every internal node, bottom up */             \
+    if (h->len > 1)                                                            \
+      for (usize i = (h->len - 2) / (D) + 1; i-- > 0;)                         \
+        name##_sift_down(h, i);                                                \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline bool name##_topk_push(name##_t *h, usize k, T val) {           \
+    if (h->len < k)                                                            \
+      return name##_push(h, val);                                              \
+    if (k == 0 || !LESS(h->ptr[0], val))                                       \
+      return false;                                                            \
+    h->ptr[0] = val;                                                           \
+    name##_sift_down(h, 0);                                                    \
+    return true;                                                               \
+  }
+
+// An indexed heap of (id, value) entries. `pos` maps each id to its entry's
+// position in the heap, or HEAP_NONE, so entries can be found and reordered
+// after their value changes. Ids should be small and dense, `pos` grows to
+// the largest id pushed. A zeroed name_t is an empty heap.
+//
+//   bool name_push(name_t *h, u32 id, T val)   id must not be in the heap
+//   name_entry_t name_pop(name_t *h)           the smallest .val and its .id
+//   name_entry_t name_peek(const name_t *h)
+//   bool name_contains(const name_t *h, u32 id)
+//   void name_decrease_key(name_t *h, u32 id, T val)
+//     `val` must not be greater than the current value of `id`
+//   void name_free(name_t *h)
+#define HEAP_DEFINE_INDEXED(name, T, LESS)                                     \
+  HEAP_DEFINE_INDEXED_ARITY(name, T, LESS, HEAP_DEFAULT_ARITY)
+
+#define HEAP_DEFINE_INDEXED_ARITY(name, T, LESS, D)                            \
+  static_assert((D) >= 2, "Heap arity must be at least 2");                    \
+  typedef struct {                                                             \
+    T val;                                                                     \
+    u32 id;                                                                    \
+  } name##_entry_t;                                                            \
+  typedef array_type(name##_entry_t) name##_entries_t;                         \
+  typedef array_type(u32) name##_pos_t;                                        \
+  typedef struct {                                                             \
+    name##_entries_t entries;                                                  \
+    name##_pos_t pos;                                                          \
+  } name##_t;                                                                  \
+                                                                               \
+  static inline void name##_sift_up(name##_t *h, usize i) {                    \
+    name##_entry_t *a = h->entries.ptr;                                        \
+    u32 *pos = h->pos.ptr;                                                     \
+    name##_entry_t e = a[i];                                                   \
+    while (i > 0) {                                                            \
+      usize parent = (i - 1) / (D);                                            \
+      if (!LESS(e.val, a[parent].val))                                         \
+        break;                                                                 \
+      a[i] = a[parent];                                                        \
+      pos[a[i].id] = (u32)i;                                                   \
+      i = parent;                                                              \
+    }                                                                          \
+    a[i] = e;                                                                  \
+    pos[e.id] = (u32)i;                                                        \
+  }                                                                            \
+                                                                               \
+  static inline void name##_sift_down(name##_t *h, usize i) {                  \
+    name##_entry_t *a = h->entries.ptr;                                        \
+    u32 *pos = h->pos.ptr;                                                     \
+    usize len = h->entries.len;                                                \
+    name##_entry_t e = a[i];                                                   \
+    for (;;) {                                                                 \
+      usize first = i * (D) + 1;                                               \
+      if (first >= len)                                                        \
+        break;                                                                 \
+      usize last = MIN_X(first + (D), len);                                    \
+      usize best = first;                                                      \
+      for (usize c = first + 1; c < last; c++)                                 \
+        best = LESS(a[c].val, a[best].val) ? c : best;                         \
+      if (!LESS(a[best].val, e.val))                                           \
+        break;                                                                 \
+      a[i] = a[best];                                                          \
+      pos[a[i].id] = (u32)i;                                                   \
+      i = best;                                                                \
+    }                                                                          \
+    a[i] = e;                                                                  \
+    pos[e.id] = (u32)i;                                                        \
+  }                                                                            \
+                                                                               \
+  static inline bool name##_contains(const name##_t *h, u32 id) {              \
+    return id < h->pos.len && h->pos.ptr[id] != HEAP_NONE;                    \
+  }                                                                            \
+                                                                               \
+  static inline bool name##_push(name##_t *h, u32 id, T val) {                 \
+    safecheck(!name##_contains(h, id));                                        \
+    while (h->pos.len <= id)                                                   \
+      if (!array_push(u32, &h->pos, (u32)HEAP_NONE))                           \
+        return false;                                                          \
+    name##_entry_t e = {.val = val, .id = id};                                 \
+    if (!array_push(name##_entry_t, &h->entries, e))                           \
+      return false;                                                            \
+    name##_sift_up(h, h->entries.len - 1);                                     \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline name##_entry_t name##_peek(const name##_t *h) {                \
+    safecheck(h->entries.len > 0);                                             \
+    return h->entries.ptr[0];                                                  \
+  }                                                                            \
+                                                                               \
+  static inline name##_entry_t name##_pop(name##_t *h) {                       \
+    safecheck(h->entries.len > 0);                                             \
+    name##_entry_t top = h->entries.ptr[0];                                    \
+    h->pos.ptr[top.id] = HEAP_NONE;                                            \
+    if (--h->entries.len > 0) {                                                \
+      h->entries.ptr[0] = h->entries.ptr[h->entries.len];                      \
+      name##_sift_down(h, 0);                                                  \
+    }                                                                          \
+    return top;                                                                \
+  }                                                                            \
+                                                                               \
+  static inline void name##_decrease_key(name##_t *h, u32 id, T val) {         \
+    safecheck(name##_contains(h, id));                                         \
+    usize i = h->pos.ptr[id];                                                  \
+    safecheck(!LESS(h->entries.ptr[i].val, val));                              \
+    h->entries.ptr[i].val = val;                                               \
+    name##_sift_up(h, i);                                                      \
+  }                                                                            \
+                                                                               \
+  static inline void name##_free(name##_t *h) {                                \
+    array_free(&h->entries);                                                   \
+    array_free(&h->pos);                                                       \
+  }
+
+ASSUME_NONNULL_END
+
+#endif // HEAP_H_
@@ -0,0 +1,169 @@
+#include "stree.h"
+#include "arena.h"
+#include "common.h"
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STREE_HAVE_AVX2
+#endif
+
+#define STREE_NODE_BYTES (STREE_B * sizeof(u32))
+// Queries walked down the tree together by stree_lower_bound_batch()
+#define STREE_BATCH 16
+
+static_assert(STREE_NODE_BYTES == ZMEM_L1_CACHE_LINE_SIZE,
+              "A node should fill exactly one cache line");
+
+static inline usize stree_child(usize k, usize i) {
+  return k * (STREE_B + 1) + i;
+}
+
+static inline const u32 *stree_node(const STree *tree, usize layer, usize k) {
+  return &tree->keys[(tree->offsets[layer] + k) * STREE_B];
+}
+
+STree stree_build(u32slice_t sorted, Arena *maybe_null arena) {
+  safecheck(sorted.len < UINT32_MAX);
+
+  STree tree = {.keys = NULL, .height = 0, .len = 0, .alloc = NULL};
+  if (!sorted.len)
+    return tree;
+
+  // Lay out the layers from the leaves up until one node covers everything
+  usize layer_nodes[STREE_MAX_HEIGHT];
+  usize nodes = (sorted.len + STREE_B - 1) / STREE_B;
+  usize total = 0;
+  usize height = 0;
+  for (;;) {
+    safecheck(height < STREE_MAX_HEIGHT);
+    layer_nodes[height] = nodes;
+    tree.offsets[height] = total;
+    total += nodes;
+    height++;
+    if (nodes == 1)
+      break;
+    nodes = (nodes + STREE_B) / (STREE_B + 1);
+  }
+
+  usize bytes = total * STREE_NODE_BYTES;
+  u8 *mem;
+  if (arena) {
+    u8 *raw = arena_alloc(arena, bytes + ZMEM_L1_CACHE_LINE_SIZE);
+    if (!raw)
+      return tree;
+    mem = (u8 *)(((usize)raw + ZMEM_L1_CACHE_LINE_SIZE - 1) &
+                 ~(usize)(ZMEM_L1_CACHE_LINE_SIZE - 1));
+  } else {
+    mem = alloc_aligned(bytes);
+    if (!mem)
+      return tree;
+    tree.alloc = mem;
+  }
+  tree.keys = (u32 *)mem;
+  tree.height = height;
+  tree.len = sorted.len;
+
+  usize nleaf_keys = layer_nodes[0] * STREE_B;
+  memcpy(tree.keys, sorted.ptr, sorted.len * sizeof(u32));
+  for (usize i = sorted.len; i < nleaf_keys; i++)
+    tree.keys[i] = UINT32_MAX;
+
+  // Key j of node k is the first key of the leftmost leaf under child j+1,
+  // or padding if that child does not exist
+  usize leaves_per_child = 1;
+  for (usize h = 1; h < height; h++) {
+    u32 *layer = &tree.keys[tree.offsets[h] * STREE_B];
+    for (usize i = 0; i < layer_nodes[h] * STREE_B; i++) {
+      usize k = i / STREE_B, j = i % STREE_B;
+      usize leaf = stree_child(k, j + 1) * leaves_per_child;
+      layer[i] = leaf * STREE_B < sorted.len ? sorted.ptr[leaf * STREE_B]
+                                              : UINT32_MAX;
+    }
+    leaves_per_child *= STREE_B + 1;
+  }
+  return tree;
+}
+
+void stree_free(STree *tree) {
+  free_aligned(tree->alloc);
+  *tree = (STree){0};
+}
+
+// Number of keys in the node that are less than x, which is also the
+// position of the first key >= x in it
+static inline usize stree_node_rank(const u32 *node, u32 x) {
+#ifdef STREE_HAVE_AVX2
+  // AVX2 only has signed comparisons, so flip the sign bit of both sides
+  const __m256i sign = _mm256_set1_epi32((int)0x80000000u);
+  __m256i xv = _mm256_xor_si256(_mm256_set1_epi32((int)x), sign);
+  __m256i lo = _mm256_xor_si256(_mm256_load_si256((const __m256i *)node), sign);
+  __m256i hi =
+      _mm256_xor_si256(_mm256_load_si256((const __m256i *)node + 1), sign);
+  u32 lo_mask = (u32)_mm256_movemask_ps(
+      _mm256_castsi256_ps(_mm256_cmpgt_epi32(xv, lo)));
+  u32 hi_mask = (u32)_mm256_movemask_ps(
+      _mm256_castsi256_ps(_mm256_cmpgt_epi32(xv, hi)));
+  return (usize)__builtin_popcount(lo_mask | (hi_mask << 8));
+#else
+  usize count = 0;
+  for (usize i = 0; i < STREE_B; i++)
+    count += node[i] < x;
+  return count;
+#endif
+}
+
+// Position in the leaf layer of the first key >= x, which may be padding
+static inline usize stree_search(const STree *tree, u32 x) {
+  usize k = 0;
+  for (usize h = tree->height - 1; h > 0; h--)
+    k = stree_child(k, stree_node_rank(stree_node(tree, h, k), x));
+  return k * STREE_B + stree_node_rank(stree_node(tree, 0, k), x);
+}
+
+usize stree_lower_bound(const STree *tree, u32 x) {
+  if (!tree->len)
+    return 0;
+  return MIN_X(stree_search(tree, x), tree->len);
+}
+
+bool stree_contains(const STree *tree, u32 x) {
+  if (!tree->len)
+    return false;
+  usize pos = stree_search(tree, x);
+  return pos < tree->len && tree->keys[pos] == x;
+}
+
+void stree_lower_bound_batch(const STree *tree, const u32 *queries, usize n,
+                             usize *out) {
+  if (!tree->len) {
+    for (usize i = 0; i < n; i++)
+      out[i] = 0;
+    return;
+  }
+
+  usize k[STREE_BATCH];
+  for (usize base = 0; base < n; base += STREE_BATCH) {
+    usize m = MIN_X(n - base, (usize)STREE_BATCH);
+    const u32 *q = &queries[base];
+    for (usize j = 0; j < m; j++)
+      k[j] = 0;
+
+    // Every query is the same number of layers deep, so advance them all one
+    // layer per pass and prefetch each one's next node, putting the misses
+    // of the whole batch in flight at once
+    for (usize h = tree->height - 1; h > 0; h--) {
+      for (usize j = 0; j < m; j++) {
+        usize i = stree_node_rank(stree_node(tree, h, k[j]), q[j]);
+        k[j] = stree_child(k[j], i);
+        __builtin_prefetch(stree_node(tree, h - 1, k[j]));
+      }
+    }
+
+    for (usize j = 0; j < m; j++) {
+      usize i = stree_node_rank(stree_node(tree, 0, k[j]), q[j]);
+      usize pos = k[j] * STREE_B + i;
+      out[base + j] = MIN_X(pos, tree->len);
+    }
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef STREE_H_
+#define STREE_H_
+
+#include "arena.h"
+#include "array.h"
+#include "common.h"
+
+ASSUME_NONNULL_BEGIN
+
+// A static B+-tree over a sorted slice of u32 keys, laid out for searching.
+//
+// Each node is STREE_B keys filling exactly one cache line. The bottom layer
+// is the sorted keys themselves, padded with UINT32_MAX to whole nodes. A
+// node in the layers above has B+1 children, and its key j is the smallest
+// key in the subtree of child j+1. Layers are stored contiguously from the
+// leaves up and nodes are numbered implicitly (child i of node k is node
+// k*(B+1)+i of the next layer down), so a lookup touches one cache line per
+// layer instead of one per comparison like binary search. Within a node the
+// keys are compared all at once with SIMD when built with -mavx2.
+//
+// Since the leaves are in sorted order, a key's position in the original
+// slice is its position in the leaf layer. The whole tree is about 1/16th
+// larger than the slice.
+//
+// The tree is read-only once built.
+//
+// Reference: https://en.algorithmica.org/hpc/data-structures/s-tree/
+
+#define STREE_B 16
+// Enough layers for any slice shorter than UINT32_MAX
+#define STREE_MAX_HEIGHT 8
+
+typedef slice_type(u32) u32slice_t;
+
+typedef struct STree {
+  // All layers, leaves first
+  u32 *maybe_null keys;
+  // Index of the first node of each layer in `keys`
+  usize offsets[STREE_MAX_HEIGHT];
+  usize height;
+  usize len;
+  // Base of the allocation holding `keys`, NULL when owned by an arena
+  void *maybe_null alloc;
+} STree;
+
+// Builds a tree from `sorted`, which must be in ascending order and have
+// fewer than UINT32_MAX elements. If `arena` is non-NULL the tree is
+// allocated from it and stree_free() is a no-op.
+//
+// Returns an empty tree (len 0) if the allocation fails, so callers that
+// care should check `len == sorted.len`.
+STree stree_build(u32slice_t sorted, Arena *maybe_null arena);
+void stree_free(STree *tree);
+
+// Position of the first element >= x, or `len` if there is none
+usize stree_lower_bound(const STree *tree, u32 x);
+bool stree_contains(const STree *tree, u32 x);
+
+// Same as stree_lower_bound() for each of `queries`, but walks several
+// queries down the tree together so their cache misses overlap
+void stree_lower_bound_batch(const STree *tree, const u32 *queries, usize n,
+                             usize *out);
+
+ASSUME_NONNULL_END
+
+#endif // STREE_H_
@@ -0,0 +1,342 @@
+#include "tlsf.h"
+#include "arena.h"
+#include "common.h"
+#include <stddef.h>
+
+// The header is `prev_phys` and `size`, the free list pointers overlap the
+// payload
+#define TLSF_HEADER_SIZE (offsetof(TlsfBlock, next_free))
+#define TLSF_MIN_BLOCK_SIZE (sizeof(TlsfBlock) - TLSF_HEADER_SIZE)
+#define TLSF_MAX_BLOCK_SIZE ((usize)1 << TLSF_FL_MAX)
+
+#define TLSF_BLOCK_FREE ((usize)1)
+#define TLSF_BLOCK_PREV_FREE ((usize)2)
+#define TLSF_BLOCK_FLAGS (TLSF_BLOCK_FREE | TLSF_BLOCK_PREV_FREE)
+
+static_assert(TLSF_HEADER_SIZE % TLSF_ALIGN == 0,
+              "Block header must preserve alignment");
+static_assert(TLSF_SL_COUNT <= 32, "Second level bitmap must fit in a u32");
+static_assert(TLSF_FL_COUNT <= 32, "First level bitmap must fit in a u32");
+
+static inline usize tlsf_align_up(usize x) {
+  return (x + (TLSF_ALIGN - 1)) & ~(usize)(TLSF_ALIGN - 1);
+}
+
+static inline usize tlsf_align_down(usize x) {
+  return x & ~(usize)(TLSF_ALIGN - 1);
+}
+
+static inline usize block_size(const TlsfBlock *block) {
+  return block->size & ~TLSF_BLOCK_FLAGS;
+}
+
+static inline void block_set_size(TlsfBlock *block, usize size) {
+  block->size = size | (block->size & TLSF_BLOCK_FLAGS);
+}
+
+static inline bool block_is_free(const TlsfBlock *block) {
+  return block->size & TLSF_BLOCK_FREE;
+}
+
+static inline bool block_is_prev_free(const TlsfBlock *block) {
+  return block->size & TLSF_BLOCK_PREV_FREE;
+}
+
+static inline void *block_to_ptr(TlsfBlock *block) {
+  return (u8 *)block + TLSF_HEADER_SIZE;
+}
+
+static inline TlsfBlock *block_from_ptr(const void *ptr) {
+  return (TlsfBlock *)((u8 *)ptr - TLSF_HEADER_SIZE);
+}
+
+static inline TlsfBlock *block_next(const TlsfBlock *block) {
+  return (TlsfBlock *)((u8 *)block + TLSF_HEADER_SIZE + block_size(block));
+}
+
+static inline TlsfBlock *block_link_next(TlsfBlock *block) {
+  TlsfBlock *next = block_next(block);
+  next->prev_phys = block;
+  return next;
+}
+
+static inline void block_mark_free(TlsfBlock *block) {
+  TlsfBlock *next = block_link_next(block);
+  next->size |= TLSF_BLOCK_PREV_FREE;
+  block->size |= TLSF_BLOCK_FREE;
+}
+
+static inline void block_mark_used(TlsfBlock *block) {
+  TlsfBlock *next = block_next(block);
+  next->size &= ~TLSF_BLOCK_PREV_FREE;
+  block->size &= ~TLSF_BLOCK_FREE;
+}
+
+// Finds the bin a block of `size` belongs in
+static inline void mapping_insert(usize size, int *fl, int *sl) {
+  if (size < TLSF_SMALL_BLOCK_SIZE) {
+    *fl = 0;
+    *sl = (int)(size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_COUNT));
+  } else {
+    int f = ILOG2(size);
+    *sl = (int)(size >> (f - TLSF_SL_COUNT_LOG2)) ^ TLSF_SL_COUNT;
+    *fl = f - (TLSF_FL_SHIFT - 1);
+  }
+}
+
+// Rounds `size` up to the next bin boundary, so that any block in the bin
+// returned is large enough
+static inline usize mapping_round(usize size) {
+  if (size >= TLSF_SMALL_BLOCK_SIZE)
+    size += ((usize)1 << (ILOG2(size) - TLSF_SL_COUNT_LOG2)) - 1;
+  return size;
+}
+
+static inline void mapping_search(usize size, int *fl, int *sl) {
+  mapping_insert(mapping_round(size), fl, sl);
+}
+
+static TlsfBlock *maybe_null find_suitable_block(Tlsf *tlsf, int *fl,
+                                                 int *sl) {
+  if (*fl >= TLSF_FL_COUNT)
+    return NULL;
+
+  u32 sl_map = tlsf->sl_bitmap[*fl] & (~0u << *sl);
+  if (!sl_map) {
+    // No block in this first level class, search the larger ones
+    u32 fl_map = *fl + 1 < 32 ? tlsf->fl_bitmap & (~0u << (*fl + 1)) : 0;
+    if (!fl_map)
+      return NULL;
+    *fl = co_ctz(fl_map);
+    sl_map = tlsf->sl_bitmap[*fl];
+  }
+  *sl = co_ctz(sl_map);
+  return tlsf->blocks[*fl][*sl];
+}
+
+static void remove_free_block(Tlsf *tlsf, TlsfBlock *block, int fl, int sl) {
+  TlsfBlock *prev = block->prev_free;
+  TlsfBlock *next = block->next_free;
+  if (next)
+    next->prev_free = prev;
+  if (prev)
+    prev->next_free = next;
+
+  if (tlsf->blocks[fl][sl] == block) {
+    tlsf->blocks[fl][sl] = next;
+    if (!next) {
+      tlsf->sl_bitmap[fl] &= ~(1u << sl);
+      if (!tlsf->sl_bitmap[fl])
+        tlsf->fl_bitmap &= ~(1u << fl);
+    }
+  }
+}
+
+static void insert_free_block(Tlsf *tlsf, TlsfBlock *block) {
+  int fl, sl;
+  mapping_insert(block_size(block), &fl, &sl);
+  TlsfBlock *head = tlsf->blocks[fl][sl];
+  block->next_free = head;
+  block->prev_free = NULL;
+  if (head)
+    head->prev_free = block;
+  tlsf->blocks[fl][sl] = block;
+  tlsf->fl_bitmap |= 1u << fl;
+  tlsf->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void unlink_free_block(Tlsf *tlsf, TlsfBlock *block) {
+  int fl, sl;
+  mapping_insert(block_size(block), &fl, &sl);
+  remove_free_block(tlsf, block, fl, sl);
+}
+
+static inline bool block_can_split(const TlsfBlock *block, usize size) {
+  return block_size(block) >= size + sizeof(TlsfBlock);
+}
+
+// Splits `block` so it is `size` bytes, returning the free remainder
+static TlsfBlock *block_split(TlsfBlock *block, usize size) {
+  TlsfBlock *rest = (TlsfBlock *)((u8 *)block_to_ptr(block) + size);
+  rest->size = block_size(block) - size - TLSF_HEADER_SIZE;
+  block_set_size(block, size);
+  block_mark_free(rest);
+  return rest;
+}
+
+// Absorbs `block` into `prev`, its physically preceding neighbour
+static TlsfBlock *block_absorb(TlsfBlock *prev, TlsfBlock *block) {
+  prev->size += block_size(block) + TLSF_HEADER_SIZE;
+  block_link_next(prev);
+  return prev;
+}
+
+static TlsfBlock *block_merge_prev(Tlsf *tlsf, TlsfBlock *block) {
+  if (block_is_prev_free(block)) {
+    TlsfBlock *prev = block->prev_phys;
+    unlink_free_block(tlsf, prev);
+    block = block_absorb(prev, block);
+  }
+  return block;
+}
+
+static TlsfBlock *block_merge_next(Tlsf *tlsf, TlsfBlock *block) {
+  TlsfBlock *next = block_next(block);
+  if (block_is_free(next)) {
+    unlink_free_block(tlsf, next);
+    block = block_absorb(block, next);
+  }
+  return block;
+}
+
+// Returns the block size used for a request, or 0 if it is too large
+static inline usize adjust_request_size(usize size) {
+  if (size >= TLSF_MAX_BLOCK_SIZE)
+    return 0;
+  return MAX(tlsf_align_up(size), TLSF_MIN_BLOCK_SIZE);
+}
+
+void tlsf_init(Tlsf *tlsf, Arena *maybe_null arena, usize pool_size) {
+  memset(tlsf, 0, sizeof(Tlsf));
+  tlsf->arena = arena;
+  tlsf->pool_size = pool_size;
+}
+
+void tlsf_destroy(Tlsf *tlsf) {
+  TlsfPool *pool = tlsf->owned_pools;
+  while (pool) {
+    TlsfPool *next = pool->next;
+    free_aligned(pool);
+    pool = next;
+  }
+  tlsf_init(tlsf, tlsf->arena, tlsf->pool_size);
+}
+
+bool tlsf_add_pool(Tlsf *tlsf, void *mem, usize bytes) {
+  usize start = tlsf_align_up((usize)mem);
+  usize skipped = start - (usize)mem;
+  if (bytes <= skipped)
+    return false;
+  usize avail = tlsf_align_down(bytes - skipped);
+
+  // The pool is one big free block followed by an empty, used sentinel block
+  // so that merging never walks off the end.
+  if (avail < 2 * TLSF_HEADER_SIZE + TLSF_MIN_BLOCK_SIZE)
+    return false;
+  usize payload = avail - 2 * TLSF_HEADER_SIZE;
+  if (payload >= TLSF_MAX_BLOCK_SIZE)
+    return false;
+
+  TlsfBlock *block = (TlsfBlock *)start;
+  block->prev_phys = NULL;
+  block->size = payload;
+  TlsfBlock *sentinel = block_next(block);
+  sentinel->size = 0;
+  block_mark_free(block);
+  insert_free_block(tlsf, block);
+  return true;
+}
+
+// Allocates a new pool that can hold a block of at least `size` bytes
+static bool tlsf_grow(Tlsf *tlsf, usize size) {
+  if (!tlsf->pool_size)
+    return false;
+
+  usize needed = mapping_round(size) + 2 * TLSF_HEADER_SIZE + TLSF_ALIGN;
+  usize bytes = MAX(tlsf->pool_size, needed);
+
+  if (tlsf->arena) {
+    void *mem = arena_alloc(tlsf->arena, bytes);
+    if (!mem)
+      return false;
+    return tlsf_add_pool(tlsf, mem, bytes);
+  }
+
+  // Pools we own start with a link so tlsf_destroy() can free them
+  u8 *mem = alloc_aligned(bytes + TLSF_ALIGN);
+  if (!mem)
+    return false;
+  static_assert(sizeof(TlsfPool) <= TLSF_ALIGN, "");
+  TlsfPool *pool = (TlsfPool *)mem;
+  pool->next = tlsf->owned_pools;
+  tlsf->owned_pools = pool;
+  return tlsf_add_pool(tlsf, mem + TLSF_ALIGN, bytes);
+}
+
+void *maybe_null tlsf_malloc(Tlsf *tlsf, usize size) {
+  usize adjusted = adjust_request_size(size);
+  if (!adjusted)
+    return NULL;
+
+  int fl, sl;
+  mapping_search(adjusted, &fl, &sl);
+  TlsfBlock *block = find_suitable_block(tlsf, &fl, &sl);
+  if (!block) {
+    if (!tlsf_grow(tlsf, adjusted))
+      return NULL;
+    mapping_search(adjusted, &fl, &sl);
+    block = find_suitable_block(tlsf, &fl, &sl);
+    if (!block)
+      return NULL;
+  }
+
+  remove_free_block(tlsf, block, fl, sl);
+  if (block_can_split(block, adjusted))
+    insert_free_block(tlsf, block_split(block, adjusted));
+  block_mark_used(block);
+  return block_to_ptr(block);
+}
+
+void tlsf_free(Tlsf *tlsf, void *maybe_null ptr) {
+  if (!ptr)
+    return;
+  TlsfBlock *block = block_from_ptr(ptr);
+  safecheckf(!block_is_free(block), "double free of %p", ptr);
+  block_mark_free(block);
+  block = block_merge_prev(tlsf, block);
+  block = block_merge_next(tlsf, block);
+  insert_free_block(tlsf, block);
+}
+
+void *maybe_null tlsf_realloc(Tlsf *tlsf, void *maybe_null ptr, usize size) {
+  if (!ptr)
+    return tlsf_malloc(tlsf, size);
+  if (size == 0) {
+    tlsf_free(tlsf, ptr);
+    return NULL;
+  }
+
+  usize adjusted = adjust_request_size(size);
+  if (!adjusted)
+    return NULL;
+
+  TlsfBlock *block = block_from_ptr(ptr);
+  usize cur_size = block_size(block);
+
+  if (adjusted > cur_size) {
+    // Grow in place if the next block is free and big enough
+    TlsfBlock *next = block_next(block);
+    usize combined = cur_size + block_size(next) + TLSF_HEADER_SIZE;
+    if (!block_is_free(next) || adjusted > combined) {
+      void *new_ptr = tlsf_malloc(tlsf, size);
+      if (new_ptr) {
+        memcpy(new_ptr, ptr, cur_size);
+        tlsf_free(tlsf, ptr);
+      }
+      return new_ptr;
+    }
+    block_merge_next(tlsf, block);
+    block_mark_used(block);
+  }
+
+  // Give back whatever is left over
+  if (block_can_split(block, adjusted)) {
+    TlsfBlock *rest = block_split(block, adjusted);
+    insert_free_block(tlsf, block_merge_next(tlsf, rest));
+  }
+  return ptr;
+}
+
+usize tlsf_block_size(const void *ptr) {
+  return block_size(block_from_ptr(ptr));
+}
@@ -0,0 +1,83 @@
+#ifndef TLSF_H_
+#define TLSF_H_
+
+#include "arena.h"
+#include "common.h"
+#include <stddef.h>
+
+ASSUME_NONNULL_BEGIN
+
+// A Two-Level Segregated Fit allocator with O(1) malloc and free.
+//
+// Free blocks are binned by size into TLSF_FL_COUNT power of two classes, each
+// split linearly into TLSF_SL_COUNT subclasses. Two levels of bitmaps record
+// which bins are non-empty, so finding a block is a couple of bit scans.
+//
+// Memory comes from pools, either added explicitly with tlsf_add_pool() or
+// grabbed on demand from the arena (or alloc_aligned() when there is none)
+// in chunks of at least `pool_size` bytes.
+//
+// References:
+// - Masmano et al., "TLSF: a New Dynamic Memory Allocator for Real-Time
+//   Systems"
+// - Matthew Conte's implementation: https://github.com/mattconte/tlsf
+
+#define TLSF_ALIGN_LOG2 4
+#define TLSF_ALIGN (1 << TLSF_ALIGN_LOG2)
+
+#define TLSF_SL_COUNT_LOG2 5
+#define TLSF_SL_COUNT (1 << TLSF_SL_COUNT_LOG2)
+
+// Blocks smaller than this all go in the first level, split in steps of
+// TLSF_ALIGN
+#define TLSF_FL_SHIFT (TLSF_SL_COUNT_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_BLOCK_SIZE ((usize)1 << TLSF_FL_SHIFT)
+// Largest block is 2^TLSF_FL_MAX bytes
+#define TLSF_FL_MAX 38
+#define TLSF_FL_COUNT (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+typedef struct TlsfBlock {
+  // Only valid when the previous physical block is free
+  struct TlsfBlock *maybe_null prev_phys;
+  // Size of the payload, the low bits hold the free flags
+  usize size;
+  // Only valid when this block is free, otherwise part of the payload
+  struct TlsfBlock *maybe_null next_free;
+  struct TlsfBlock *maybe_null prev_free;
+} TlsfBlock;
+
+// A pool owned by the allocator, freed by tlsf_destroy()
+typedef struct TlsfPool {
+  struct TlsfPool *maybe_null next;
+} TlsfPool;
+
+typedef struct Tlsf {
+  u32 fl_bitmap;
+  u32 sl_bitmap[TLSF_FL_COUNT];
+  TlsfBlock *maybe_null blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+  Arena *maybe_null arena;
+  // Minimum size of pools allocated on demand, 0 disables growing
+  usize pool_size;
+  TlsfPool *maybe_null owned_pools;
+} Tlsf;
+
+// `arena` may be NULL, in which case pools come from alloc_aligned()
+void tlsf_init(Tlsf *tlsf, Arena *maybe_null arena, usize pool_size);
+// Frees pools allocated with alloc_aligned(), arena pools are left to the
+// arena
+void tlsf_destroy(Tlsf *tlsf);
+// Adds `bytes` of memory starting at `mem` for the allocator to use. Returns
+// false if the region is too small or too large to be a pool.
+bool tlsf_add_pool(Tlsf *tlsf, void *mem, usize bytes);
+
+// Returned pointers are aligned to TLSF_ALIGN
+void *maybe_null tlsf_malloc(Tlsf *tlsf, usize size);
+void *maybe_null tlsf_realloc(Tlsf *tlsf, void *maybe_null ptr, usize size);
+void tlsf_free(Tlsf *tlsf, void *maybe_null ptr);
+// Usable size of an allocation, which may be larger than requested
+usize tlsf_block_size(const void *ptr);
+
+ASSUME_NONNULL_END
+
+#endif // TLSF_H_
@@ -0,0 +1,170 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+#include "arena.h"
+#include "common.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+_Thread_local TraceBuffer *maybe_null _trace_thread_buffer = NULL;
+
+static Arena *maybe_null trace_arena = NULL;
+static usize trace_capacity = 0;
+// Guards `trace_arena`, which is only touched the first time each thread
+// records a zone
+static atomic_flag trace_arena_lock = ATOMIC_FLAG_INIT;
+static _Atomic(TraceBuffer *) trace_buffers = NULL;
+static atomic_uint trace_next_tid = 1;
+
+static u64 trace_start = 0;
+static double trace_ticks_per_us = 1.0;
+
+static u64 trace_monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+// Works out how many trace_now() ticks there are per microsecond
+static double trace_calibrate(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  // The TSC has no architectural way to query its frequency, so measure it
+  // against the monotonic clock over a few milliseconds.
+  u64 ns_begin = trace_monotonic_ns();
+  u64 tsc_begin = trace_now();
+  u64 ns_end;
+  do {
+    ns_end = trace_monotonic_ns();
+  } while (ns_end - ns_begin < 10000000ull);
+  u64 tsc_end = trace_now();
+  return (double)(tsc_end - tsc_begin) / ((double)(ns_end - ns_begin) / 1e3);
+#elif defined(__aarch64__)
+  u64 freq;
+  __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+  return (double)freq / 1e6;
+#else
+  return 1e3;
+#endif
+}
+
+void _trace_init(Arena *arena, usize events_per_thread) {
+  safecheck(events_per_thread > 0);
+  trace_arena = arena;
+  trace_capacity = CEIL_POW2(events_per_thread);
+  trace_ticks_per_us = trace_calibrate();
+  trace_start = trace_now();
+}
+
+TraceBuffer *maybe_null _trace_thread_buffer_slow(void) {
+  if (!trace_arena)
+    return NULL;
+
+  while (atomic_flag_test_and_set_explicit(&trace_arena_lock,
+                                           memory_order_acquire))
+    ;
+  TraceBuffer *buf = arena_alloc(trace_arena, sizeof(TraceBuffer));
+  TraceEvent *events =
+      arena_alloc(trace_arena, trace_capacity * sizeof(TraceEvent));
+  atomic_flag_clear_explicit(&trace_arena_lock, memory_order_release);
+  if (!buf || !events)
+    return NULL;
+
+  *buf = (TraceBuffer){
+      .mask = trace_capacity - 1,
+      .tid = atomic_fetch_add_explicit(&trace_next_tid, 1,
+                                       memory_order_relaxed),
+      .events = events,
+      .next = NULL,
+  };
+  atomic_init(&buf->head, 0);
+  atomic_init(&buf->thread_name, NULL);
+
+  TraceBuffer *head = atomic_load_explicit(&trace_buffers, memory_order_relaxed);
+  do {
+    buf->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(
+      &trace_buffers, &head, buf, memory_order_release, memory_order_relaxed));
+
+  _trace_thread_buffer = buf;
+  return buf;
+}
+
+void trace_thread_name(const char *name) {
+  TraceBuffer *buf = _trace_thread_buffer;
+  if (!buf)
+    buf = _trace_thread_buffer_slow();
+  if (buf)
+    atomic_store_explicit(&buf->thread_name, name, memory_order_release);
+}
+
+static void trace_write_string(FILE *fp, const char *str) {
+  fputc('"', fp);
+  for (const char *c = str; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      fprintf(fp, "\\%c", *c);
+    else if ((u8)*c < 0x20)
+      fprintf(fp, "\\u%04x", (u8)*c);
+    else
+      fputc(*c, fp);
+  }
+  fputc('"', fp);
+}
+
+bool trace_flush(const char *path) {
+  FILE *fp = fopen(path, "w");
+  if (!fp)
+    return false;
+
+  fprintf(fp, "{\"traceEvents\":[");
+  bool first = true;
+
+  for (TraceBuffer *buf =
+           atomic_load_explicit(&trace_buffers, memory_order_acquire);
+       buf != NULL; buf = buf->next) {
+    const char *thread_name =
+        atomic_load_explicit(&buf->thread_name, memory_order_acquire);
+    if (thread_name) {
+      fprintf(fp,
+              "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+              "\"tid\":%u,\"args\":{\"name\":",
+              first ? "" : ",", buf->tid);
+      trace_write_string(fp, thread_name);
+      fprintf(fp, "}}");
+      first = false;
+    }
+
+    u64 head = atomic_load_explicit(&buf->head, memory_order_acquire);
+    u64 capacity = buf->mask + 1;
+    u64 start = head > capacity ? head - capacity : 0;
+    for (u64 i = start; i < head; i++) {
+      TraceEvent *ev = &buf->events[i & buf->mask];
+      u64 seq = atomic_load_explicit(&ev->seq, memory_order_acquire);
+      if (seq != i + 1)
+        continue;
+      const char *name = atomic_load_explicit(&ev->name, memory_order_relaxed);
+      u64 begin = atomic_load_explicit(&ev->begin, memory_order_relaxed);
+      u64 end = atomic_load_explicit(&ev->end, memory_order_relaxed);
+
+      // The owning thread may have started writing a later event into this
+      // slot while we copied it, in which case the copy could mix fields of
+      // two zones and `seq` has changed.
+      atomic_thread_fence(memory_order_acquire);
+      if (atomic_load_explicit(&ev->seq, memory_order_relaxed) != seq)
+        continue;
+
+      double ts = (double)(i64)(begin - trace_start) / trace_ticks_per_us;
+      double dur = (double)(end - begin) / trace_ticks_per_us;
+      fprintf(fp, "%s\n{\"name\":", first ? "" : ",");
+      trace_write_string(fp, name);
+      fprintf(fp,
+              ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+              buf->tid, ts, dur);
+      first = false;
+    }
+  }
+
+  fprintf(fp, "\n]}\n");
+  bool ok = !ferror(fp);
+  return fclose(fp) == 0 && ok;
+}
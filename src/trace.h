@@ -0,0 +1,147 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "arena.h"
+#include "common.h"
+#include <stdatomic.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#include <time.h>
+#endif
+
+ASSUME_NONNULL_BEGIN
+
+// Low-overhead scoped zone tracing.
+//
+// Each thread records completed zones into its own fixed-size ring buffer
+// (allocated from the arena passed to trace_init()), so recording a zone is
+// two timestamp reads and a store with no locking. When a ring fills up the
+// oldest events are overwritten. trace_flush() writes everything recorded so
+// far as Chrome trace_event JSON, which can be opened in Perfetto or
+// chrome://tracing.
+//
+// Zones are only recorded when compiled with -DTRACE=1, otherwise TRACE_ZONE
+// expands to nothing and trace_init() does nothing.
+//
+//   trace_init(&arena, 1 << 16);
+//   {
+//     TRACE_ZONE("update");
+//     ...
+//   }
+//   trace_flush("trace.json");
+
+#if TRACE
+#define TRACE_ENABLED 1
+#endif
+
+// Fields are atomic so trace_flush() can read slots that their thread may be
+// overwriting at the same time. Relaxed loads and stores compile to plain
+// moves.
+typedef struct TraceEvent {
+  // Must have static lifetime, usually a string literal
+  _Atomic(const char *) name;
+  _Atomic(u64) begin;
+  _Atomic(u64) end;
+  // Index of the event in the slot plus one, or 0 while it is being written
+  _Atomic(u64) seq;
+} TraceEvent;
+
+typedef struct TraceBuffer {
+  // Only written by the owning thread. `head` counts every event ever
+  // written, the slot is `head & mask`.
+  _Atomic(u64) head;
+  u64 mask;
+  u32 tid;
+  _Atomic(const char *maybe_null) thread_name;
+  TraceEvent *events;
+  struct TraceBuffer *maybe_null next;
+} TraceBuffer;
+
+typedef struct TraceZone {
+  const char *name;
+  u64 begin;
+} TraceZone;
+
+// Sets up tracing, `events_per_thread` is rounded up to a power of two.
+// The arena must outlive all tracing and is only touched when a thread
+// records its first zone. Those allocations are only serialised against each
+// other, so nothing else may use the arena while threads can still be
+// recording their first zone.
+void _trace_init(Arena *arena, usize events_per_thread);
+// Names the calling thread in the exported trace
+void trace_thread_name(const char *name);
+// Writes all recorded events to `path`, returns false if the file could not be
+// written. It can run while other threads record zones: those zones may or
+// may not be included, and slots overwritten during the flush are skipped.
+bool trace_flush(const char *path);
+
+TraceBuffer *maybe_null _trace_thread_buffer_slow(void);
+extern _Thread_local TraceBuffer *maybe_null _trace_thread_buffer;
+
+#if TRACE_ENABLED
+#define trace_init(arena, events_per_thread)                                   \
+  _trace_init((arena), (events_per_thread))
+#else
+// Skips allocating buffers and calibrating the clock, nothing is recorded
+#define trace_init(arena, events_per_thread)                                   \
+  ((void)(arena), (void)(events_per_thread))
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline u64 trace_now(void) { return __rdtsc(); }
+#elif defined(__aarch64__)
+static inline u64 trace_now(void) {
+  u64 t;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+}
+#else
+static inline u64 trace_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+#endif
+
+static inline TraceZone trace_zone_begin(const char *name) {
+  return (TraceZone){.name = name, .begin = trace_now()};
+}
+
+static inline void trace_zone_end(TraceZone *zone) {
+  u64 end = trace_now();
+  TraceBuffer *buf = _trace_thread_buffer;
+  if (UNLIKELY(!buf)) {
+    buf = _trace_thread_buffer_slow();
+    if (!buf)
+      return;
+  }
+  u64 head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+  TraceEvent *ev = &buf->events[head & buf->mask];
+  // Seqlock write. Pairs with the acquire fence in trace_flush(): a flush
+  // that sees any of the new fields also sees `seq` changed, so it knows the
+  // slot was being overwritten.
+  atomic_store_explicit(&ev->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&ev->name, zone->name, memory_order_relaxed);
+  atomic_store_explicit(&ev->begin, zone->begin, memory_order_relaxed);
+  atomic_store_explicit(&ev->end, end, memory_order_relaxed);
+  atomic_store_explicit(&ev->seq, head + 1, memory_order_release);
+  atomic_store_explicit(&buf->head, head + 1, memory_order_release);
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#if TRACE_ENABLED
+#define TRACE_ZONE(name)                                                       \
+  TraceZone TRACE_CONCAT(trace_zone_, __COUNTER__)                             \
+      __attribute__((cleanup(trace_zone_end))) = trace_zone_begin(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#endif
+
+ASSUME_NONNULL_END
+
+#endif // TRACE_H_